@@ -131,6 +131,10 @@ VOID CALLBACK WorkCallback(PTP_CALLBACK_INSTANCE, PVOID ctx, PTP_WORK) {
     Sha256File(hIn, hash);
     Log(item->hLbLog, L"SHA-256 = %02X%02X%02X...", hash[0], hash[1], hash[2]);
 
+    // Sha256File 已读到 EOF，加密前回到文件头（Linux 版 onebox_linux.cc 改为单遍流水线）
+    LARGE_INTEGER zero{};
+    SetFilePointerEx(hIn, zero, nullptr, FILE_BEGIN);
+
     WCHAR aesPath[MAX_PATH];
     StringCbPrintfW(aesPath, sizeof(aesPath), L"%s.aes", item->srcPath.c_str());
     HANDLE hOut = CreateFileW(aesPath, GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, 0, nullptr);